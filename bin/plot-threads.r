@@ -0,0 +1,87 @@
+ALIGN_BITS <- c (4)
+RANDOM_BITS <- c (6, 12)
+REUSE_PADDING <- c (0, 1)
+MODES <- c ("churn", "transfer")
+BLOCK_SIZES <- c (64, 512)
+THREADS <- 1:parallel::detectCores ()
+
+# Read input files
+
+read_results <- function (name, pattern)
+{
+  results <- c ()
+  files <- list.files (name, full.names=TRUE)
+  for (file in files)
+  {
+    lines <- readLines (file)
+    line <- grep (pattern, lines, value=TRUE)
+    result <- as.numeric (sub (".*: ([0-9.]+) .*", "\\1", line))
+    if ((length (result) == 1) && (result > 0)) results <- c (results, result)
+  }
+
+  return (results)
+}
+
+read_means <- function (prefix, pattern)
+{
+  unlist (lapply (THREADS, function (threads) mean (read_results (paste (prefix, threads, sep="-"), pattern))))
+}
+
+# Plot one value against thread count for all configurations
+
+plot_graph <- function (name, prefix_list, pattern, label)
+{
+  means_list <- lapply (prefix_list, read_means, pattern)
+  value_list <- unlist (means_list)
+  vertical_limits <- c (0, max (value_list, na.rm=TRUE))
+
+  postscript (paste (name, "ps", sep="."))
+
+  plot (c (), xlim = range (THREADS), ylim = vertical_limits, xlab="Threads", ylab=label)
+  for (prefix_index in 1:length (prefix_list))
+  {
+    lines (THREADS, means_list [[prefix_index]], type = "b", pch = prefix_index, col = prefix_index)
+  }
+
+  legend (
+    "bottomleft",
+    prefix_list,
+    pch = 1:length (prefix_list),
+    col = 1:length (prefix_list))
+
+  dev.off ()
+
+  return (means_list)
+}
+
+# Per thread throughput shows constant overhead as parallel lines
+# Resident size shows the memory overhead, padding reuse should lower it
+
+for (mode in MODES)
+{
+  for (size in BLOCK_SIZES)
+  {
+    prefix_list <- c (paste ("threads", mode, size, "vanilla", sep="-"))
+    for (align in ALIGN_BITS)
+    {
+      for (random in RANDOM_BITS)
+      {
+        for (reuse in REUSE_PADDING)
+        {
+          prefix_list <- c (prefix_list, paste ("threads", mode, size, "randomized", align, random, reuse, sep="-"))
+        }
+      }
+    }
+
+    name <- paste ("threads", mode, size, sep="-")
+    throughput <- plot_graph (paste (name, "throughput", sep="-"), prefix_list, "Operations per thread: [0-9.]+ ops/sec", "Operations per thread per second")
+    resident <- plot_graph (paste (name, "resident", sep="-"), prefix_list, "Maximum resident size: [0-9]+ kB", "Maximum resident size [kB]")
+
+    # Tabulate both values side by side for the highest thread count
+    table <- data.frame (
+      configuration = prefix_list,
+      throughput = unlist (lapply (throughput, tail, 1)),
+      resident = unlist (lapply (resident, tail, 1)))
+    write.table (table, paste (name, "txt", sep="."), row.names=FALSE, quote=FALSE)
+  }
+}
@@ -20,12 +20,17 @@ limitations under the License.
 #include <dlfcn.h>
 #include <alloca.h>
 #include <assert.h>
+#include <errno.h>
+#include <malloc.h>
+#include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
 
+#include "alloc-randomizer.h"
+
 
 //---------------------------------------------------------------
 // Utility Functions
@@ -56,12 +61,17 @@ limitations under the License.
 #define MALLOC_ALIGN_MASK_IN BITS_TO_MASK_IN (MALLOC_ALIGN_BITS)
 #define MALLOC_ALIGN_MASK_OUT BITS_TO_MASK_OUT (MALLOC_ALIGN_BITS)
 
+/// Assumed cache line size.
+/// Shared data that is written is kept apart from shared data that is only read.
+#define CACHE_LINE_SIZE 64
+
 
 //---------------------------------------------------------------
 // Helpers
 
 
-static volatile void *do_not_optimize;
+/// Written by each new thread, hence thread local to avoid sharing.
+static __thread volatile void *do_not_optimize;
 
 
 //---------------------------------------------------------------
@@ -95,41 +105,128 @@ static inline uint_fast32_t rand (int bits)
 // Library Configuration
 
 
-/// Address alignment, expressed as number of bits.
-static volatile unsigned int align_bits = 0;
-static volatile size_t align_size = BITS_TO_SIZE (0);
-static volatile uintptr_t align_mask_in = BITS_TO_MASK_IN (0);
-static volatile uintptr_t align_mask_out = BITS_TO_MASK_OUT (0);
+/// Alignment and randomization applied to allocated blocks.
+struct policy_t
+{
+  /// Address alignment, expressed as number of bits.
+  unsigned int align_bits;
+  size_t align_size;
+  uintptr_t align_mask_in;
+  uintptr_t align_mask_out;
+  /// Address randomization, expressed as number of bits.
+  unsigned int random_bits;
+};
+
+
+/// Policy used by threads that did not push their own.
+/// Both bit counts are kept in a single word, so that other threads
+/// can change the policy atomically while allocations take place.
+/// Read by every allocation but written only by configuration changes, hence kept on its own cache line.
+static uint32_t global_policy_bits __attribute__ ((aligned (CACHE_LINE_SIZE))) = 0;
+
+#define POLICY_BITS(a,r) ((((uint32_t) (a)) << 16) | ((uint32_t) (r)))
+#define POLICY_BITS_ALIGN(x) ((x) >> 16)
+#define POLICY_BITS_RANDOM(x) ((x) & 0xFFFF)
+
+/// Largest bit count accepted for both alignment and randomization.
+/// Limited by the width of the random generator.
+#define POLICY_BITS_MAX RAND_BITS
+
+/// Reuse of block prefixes for small blocks, see the padding reuse functions.
+static bool reuse_padding = false;
+
+/// Policy used by threads that paused the library.
+static const policy_t paused_policy = { 0, BITS_TO_SIZE (0), BITS_TO_MASK_IN (0), BITS_TO_MASK_OUT (0), 0 };
+
+
+/// Maximum number of nested thread policies.
+/// Increase if applications nest deeper.
+#define POLICY_DEPTH 16
+
+static __thread policy_t thread_policy [POLICY_DEPTH];
+static __thread unsigned int thread_policy_depth;
+static __thread unsigned int thread_pause_depth;
 
-/// Address randomization, expressed as number of bits.
-static volatile unsigned int random_bits = 0;
+
+static inline bool valid_policy_bits (unsigned int ab, unsigned int rb)
+{
+  return ((ab <= POLICY_BITS_MAX) && (rb <= POLICY_BITS_MAX));
+}
+
+
+static inline void make_policy (policy_t *policy, unsigned int ab, unsigned int rb)
+{
+  policy->align_bits = ab;
+  policy->align_size = BITS_TO_SIZE (ab);
+  policy->align_mask_in = BITS_TO_MASK_IN (ab);
+  policy->align_mask_out = BITS_TO_MASK_OUT (ab);
+  policy->random_bits = rb;
+}
+
+
+/** Set align bits and random bits in global configuration.
+ *
+ * The change is atomic, allocations see either the old or the new configuration.
+ */
+static void set_global_bits (unsigned int ab, unsigned int rb)
+{
+  __atomic_store_n (&global_policy_bits, POLICY_BITS (ab, rb), __ATOMIC_RELAXED);
+}
 
 
 /** Set align bits in global configuration.
  *
- * This function is not thread safe and should not be called in parallel with allocation functions.
+ * This function is not thread safe and should not be called in parallel with other configuration changes.
  */
 static void set_align_bits (unsigned int ab)
 {
-  align_bits = ab;
-  align_size = BITS_TO_SIZE (ab);
-  align_mask_in = BITS_TO_MASK_IN (ab);
-  align_mask_out = BITS_TO_MASK_OUT (ab);
+  uint32_t bits = __atomic_load_n (&global_policy_bits, __ATOMIC_RELAXED);
+  set_global_bits (ab, POLICY_BITS_RANDOM (bits));
 }
 
 
 /** Set random bits in global configuration.
  *
- * This function is not thread safe and should not be called in parallel with allocation functions.
+ * This function is not thread safe and should not be called in parallel with other configuration changes.
  */
 static void set_random_bits (unsigned int rb)
 {
-  random_bits = rb;
+  uint32_t bits = __atomic_load_n (&global_policy_bits, __ATOMIC_RELAXED);
+  set_global_bits (POLICY_BITS_ALIGN (bits), rb);
+}
+
+
+/** Set padding reuse in global configuration.
+ *
+ * This function is not thread safe and should not be called in parallel with allocation functions.
+ */
+static void set_reuse_padding (bool rp)
+{
+  reuse_padding = rp;
+}
+
+
+/** Return a snapshot of the policy that applies to the calling thread.
+ *
+ * The global policy is only used when the thread has no policy of its own.
+ * The snapshot is derived from a single read of the global policy,
+ * hence the masks always match each other.
+ */
+static inline policy_t current_policy (void)
+{
+  if (__builtin_expect (thread_pause_depth, false)) return (paused_policy);
+  if (__builtin_expect (thread_policy_depth, false)) return (thread_policy [thread_policy_depth - 1]);
+
+  policy_t policy;
+  uint32_t bits = __atomic_load_n (&global_policy_bits, __ATOMIC_RELAXED);
+  make_policy (&policy, POLICY_BITS_ALIGN (bits), POLICY_BITS_RANDOM (bits));
+  return (policy);
 }
 
 
 #define ENV_ALIGN_BITS "AR_ALIGN_BITS"
 #define ENV_RANDOM_BITS "AR_RANDOM_BITS"
+#define ENV_REUSE_PADDING "AR_REUSE_PADDING"
 
 /**
  * Initialize the configuration using the environment variables.
@@ -139,11 +236,15 @@ static void read_configuration ()
   // This function is called during initialization.
   // Hence, it needs to limit allocation as much as possible.
 
+  // Values out of range are ignored.
   const char *config_align_bits = getenv (ENV_ALIGN_BITS);
-  if (config_align_bits) set_align_bits (atoi (config_align_bits));
+  if (config_align_bits && valid_policy_bits (atoi (config_align_bits), 0)) set_align_bits (atoi (config_align_bits));
 
   const char *config_random_bits = getenv (ENV_RANDOM_BITS);
-  if (config_random_bits) set_random_bits (atoi (config_random_bits));
+  if (config_random_bits && valid_policy_bits (0, atoi (config_random_bits))) set_random_bits (atoi (config_random_bits));
+
+  const char *config_reuse_padding = getenv (ENV_REUSE_PADDING);
+  if (config_reuse_padding) set_reuse_padding (atoi (config_reuse_padding));
 }
 
 
@@ -156,6 +257,9 @@ static void *(*original_realloc) (void *ptr, size_t size) = NULL;
 static void *(*original_calloc) (size_t nmemb, size_t size) = NULL;
 static void *(*original_malloc) (size_t size) = NULL;
 static void (*original_free) (void *ptr) = NULL;
+static size_t (*original_malloc_usable_size) (void *ptr) = NULL;
+static int (*original_malloc_trim) (size_t pad) = NULL;
+static int (*original_malloc_info) (int options, FILE *stream) = NULL;
 
 
 void intercept_functions ()
@@ -168,6 +272,9 @@ void intercept_functions ()
   original_calloc = (void *(*) (size_t, size_t)) dlsym (RTLD_NEXT, "calloc");
   original_malloc = (void *(*) (size_t)) dlsym (RTLD_NEXT, "malloc");
   original_free = (void (*) (void *)) dlsym (RTLD_NEXT, "free");
+  original_malloc_usable_size = (size_t (*) (void *)) dlsym (RTLD_NEXT, "malloc_usable_size");
+  original_malloc_trim = (int (*) (size_t)) dlsym (RTLD_NEXT, "malloc_trim");
+  original_malloc_info = (int (*) (int, FILE *)) dlsym (RTLD_NEXT, "malloc_info");
 }
 
 
@@ -184,7 +291,9 @@ void intercept_functions ()
 #define BACKUP_SIZE 16384
 
 static char backup_heap [BACKUP_SIZE] __attribute__ ((aligned (MALLOC_ALIGN_SIZE)));
-static char *backup_last = backup_heap;
+
+/// Only used while initializing, kept apart from data read by every allocation.
+static char *backup_last __attribute__ ((aligned (CACHE_LINE_SIZE))) = backup_heap;
 static volatile bool backup_lock = false;
 
 
@@ -211,7 +320,8 @@ static inline void *backup_malloc (size_t size)
 // Wrapper Utilities
 
 
-static volatile bool initialized = false;
+/// Read by every allocation but written only once, hence kept on its own cache line.
+static volatile bool initialized __attribute__ ((aligned (CACHE_LINE_SIZE))) = false;
 static volatile bool initializing = false;
 
 
@@ -235,6 +345,10 @@ static void initialize (void)
 // Heap Allocator Wrapper
 
 
+/// Allocation statistics of the thread.
+static __thread ar_stats_t thread_stats;
+
+
 /// Block header used by the backup allocator.
 struct block_header_t
 {
@@ -252,19 +366,19 @@ struct block_header_t
  * 2. Reserve for alignment.
  * 3. Randomization.
  */
-static inline size_t calculate_heap_reserve (void)
+static inline size_t calculate_heap_reserve (const policy_t *policy)
 {
   // Part one, reserve for block header.
   // Calculated as minimum aligned size sufficient to hold the header.
-  size_t reserve_block_header = (sizeof (block_header_t) + align_size - 1) & align_mask_out;
+  size_t reserve_block_header = (sizeof (block_header_t) + policy->align_size - 1) & policy->align_mask_out;
 
   // Part two, reserve for alignment.
   // Calculated as maximum difference between alignments.
-  size_t reserve_alignment = align_mask_in & MALLOC_ALIGN_MASK_OUT;
+  size_t reserve_alignment = policy->align_mask_in & MALLOC_ALIGN_MASK_OUT;
 
   // Part three, randomization.
   // Calculated as random offset with alignment.
-  size_t reserve_random = rand (random_bits) & align_mask_out;
+  size_t reserve_random = rand (policy->random_bits) & policy->align_mask_out;
 
   // Reserve for block header and reserve for alignment can overlap.
   // Otherwise the reserves add up.
@@ -274,6 +388,196 @@ static inline size_t calculate_heap_reserve (void)
 }
 
 
+//---------------------------------------------------------------
+// Padding Reuse
+//
+// With many random bits, most of the extra space allocated
+// for a block is the unused prefix before the block header.
+// When padding reuse is enabled, the prefix of such host block
+// starts with a padding record and the rest of the prefix
+// is used for later small blocks of the same thread.
+//
+// Blocks in the prefix have the usual header, with the address
+// pointing to the padding record and tagged. The host block
+// header is tagged the same way. The padding record counts
+// the references from the host block, the blocks placed
+// in the prefix, and the thread that places them,
+// the original block is freed with the last reference.
+//
+// Blocks placed in the prefix keep the whole host block
+// allocated even after the host block is freed. Only
+// blocks not larger than their prefix can become hosts,
+// which bounds the pinned payload by the prefix size.
+
+
+/// Smallest prefix worth reusing, including the padding record.
+#define PADDING_MIN 256
+
+/// Largest block placed in a reused prefix.
+#define PADDING_BLOCK_MAX 128
+
+/// Largest prefix and payload of a host block together.
+/// Kept well below the threshold where the original allocator switches to separate mappings.
+#define PADDING_HOST_MAX 16384
+
+/// Tag in header address that marks padding record references.
+/// Original blocks are aligned, hence the bit is otherwise zero.
+#define PADDING_TAG ((uintptr_t) 1)
+
+#define PADDING_TAGGED(p) (((uintptr_t) (p)) & PADDING_TAG)
+#define PADDING_TAGGED_SET(p) ((void *) (((uintptr_t) (p)) | PADDING_TAG))
+#define PADDING_TAGGED_CLEAR(p) ((padding_t *) (((uintptr_t) (p)) & ~PADDING_TAG))
+
+
+/// Padding record at the start of a reused prefix.
+struct padding_t
+{
+  /// Number of references that keep the original block allocated.
+  volatile size_t references;
+  /// First free position in the prefix, only moved by the owner thread.
+  char *next;
+  /// End of the prefix, which is the host block header.
+  char *end;
+};
+
+#define PADDING_RECORD_SIZE ((sizeof (padding_t) + MALLOC_ALIGN_SIZE - 1) & MALLOC_ALIGN_MASK_OUT)
+
+
+/// Prefix currently used for small blocks of the thread.
+static __thread padding_t *thread_padding;
+
+/// Key whose destructor releases the prefix when the thread exits.
+/// Used instead of code after the thread routine because threads can also exit or be canceled.
+static pthread_key_t padding_key;
+static pthread_once_t padding_key_once = PTHREAD_ONCE_INIT;
+
+
+static inline void padding_release (padding_t *padding)
+{
+  if (__sync_sub_and_fetch (&padding->references, 1) == 0) (*original_free) (padding);
+}
+
+
+/** Release the prefix currently used by the thread.
+ */
+static inline void padding_detach (void)
+{
+  padding_t *padding = thread_padding;
+  thread_padding = NULL;
+  if (padding) padding_release (padding);
+}
+
+
+static void padding_key_destructor (void *)
+{
+  padding_detach ();
+}
+
+
+static void padding_key_create (void)
+{
+  pthread_key_create (&padding_key, padding_key_destructor);
+}
+
+
+/** Place a small block in the prefix currently used by the thread.
+ *
+ * The block is aligned and randomized the same way a block allocated by the wrapper would be.
+ * Returns null when the block does not fit.
+ */
+static inline void *padding_malloc (size_t size_original, const policy_t *policy)
+{
+  padding_t *padding = thread_padding;
+  size_t reserve = calculate_heap_reserve (policy);
+  void *block_shifted = MASKED_POINTER (padding->next + reserve, policy->align_mask_out);
+  // Empty blocks still take one byte, otherwise they could start at the host block.
+  if ((char *) block_shifted + MAX (size_original, 1) > padding->end) return (NULL);
+
+  // The space between the free position and the block is the reserve of the block.
+  thread_stats.bytes_reserved += (char *) block_shifted - padding->next;
+
+  // The next block starts after this one.
+  // Blocks placed in the prefix keep their original alignment.
+  padding->next = (char *) (((uintptr_t) block_shifted + size_original + MALLOC_ALIGN_SIZE - 1) & MALLOC_ALIGN_MASK_OUT);
+
+  block_header_t *block_header = (block_header_t *) block_shifted - 1;
+  assert ((char *) block_header >= (char *) padding + PADDING_RECORD_SIZE);
+  block_header->address = PADDING_TAGGED_SET (padding);
+  block_header->size = size_original;
+  __sync_add_and_fetch (&padding->references, 1);
+
+  thread_stats.allocations ++;
+  thread_stats.bytes_requested += size_original;
+  thread_stats.padding_allocations ++;
+  thread_stats.padding_bytes += size_original;
+
+  return (block_shifted);
+}
+
+
+/** Turn the prefix of a newly allocated block into a padding record when the prefix is large enough.
+ *
+ * The block itself must be small compared to its prefix, because it stays allocated as long as the prefix is used.
+ * The thread switches to the new prefix when it has more free space than the current one.
+ * Returns the address to store in the block header.
+ */
+static inline void *padding_create (void *block_original, block_header_t *block_header, size_t size_original)
+{
+  size_t prefix = (char *) block_header - (char *) block_original;
+  if (prefix < PADDING_MIN) return (block_original);
+  if (size_original > prefix) return (block_original);
+  if (prefix + size_original > PADDING_HOST_MAX) return (block_original);
+
+  // The free position can be past the end when the end is not aligned.
+  padding_t *padding_current = thread_padding;
+  if (padding_current && (padding_current->next + prefix - PADDING_RECORD_SIZE <= padding_current->end)) return (block_original);
+
+  // References from the host block and from the thread.
+  padding_t *padding = (padding_t *) block_original;
+  padding->references = 2;
+  padding->next = (char *) block_original + PADDING_RECORD_SIZE;
+  padding->end = (char *) block_header;
+
+  thread_padding = padding;
+  if (padding_current) padding_release (padding_current);
+
+  // The destructor only runs for keys with a value.
+  // Prefixes attached by other destructors are released in the next destructor round.
+  pthread_once (&padding_key_once, padding_key_create);
+  pthread_setspecific (padding_key, padding);
+
+  return (PADDING_TAGGED_SET (padding));
+}
+
+
+/** Calculates the usable size of a block returned by the wrapper.
+ *
+ * The usable size of the original block is reduced by the shift of the returned position.
+ * Backup blocks are never resized, hence only the requested size is reported for them.
+ */
+static inline size_t calculate_usable_size (void *block_shifted)
+{
+  block_header_t *block_header = (block_header_t *) block_shifted - 1;
+  if (backup_pointer (block_shifted)) return (block_header->size);
+
+  void *block_original = block_header->address;
+  if (PADDING_TAGGED (block_original))
+  {
+    // Blocks placed in a prefix can not use the space after them.
+    // Only the host block has its header at the end of the prefix.
+    padding_t *padding = PADDING_TAGGED_CLEAR (block_original);
+    if ((char *) block_header < padding->end) return (block_header->size);
+    block_original = padding;
+  }
+
+  size_t size_original = (*original_malloc_usable_size) (block_original);
+  size_t shift = (char *) block_shifted - (char *) block_original;
+  assert (size_original >= shift + block_header->size);
+
+  return (size_original - shift);
+}
+
+
 extern "C" void *realloc (void *source_address, size_t destination_size)
 {
   // The functions called from here take care of initialization and alignment and randomization.
@@ -283,9 +587,9 @@ extern "C" void *realloc (void *source_address, size_t destination_size)
 
   // Resizing the block while preserving data, alignment and randomization is difficult.
   // We therefore simply always allocate a new one and copy the data.
-  block_header_t *source_header = (block_header_t *) source_address - 1;
-  size_t source_size = source_header->size;
-  
+  // The caller is allowed to use the entire usable size, not just the requested size.
+  size_t source_size = malloc_usable_size (source_address);
+
   void *destination_address = malloc (destination_size);
   memcpy (destination_address, source_address, MIN (source_size, destination_size));
   free (source_address);
@@ -294,6 +598,22 @@ extern "C" void *realloc (void *source_address, size_t destination_size)
 }
 
 
+extern "C" void *reallocarray (void *source_address, size_t item_count, size_t item_size)
+{
+  // The functions called from here take care of initialization and alignment and randomization.
+
+  // Overflow is reported the same way the standard library does.
+  size_t total_size;
+  if (__builtin_mul_overflow (item_count, item_size, &total_size))
+  {
+    errno = ENOMEM;
+    return (NULL);
+  }
+
+  return (realloc (source_address, total_size));
+}
+
+
 extern "C" void *calloc (size_t item_count, size_t item_size)
 {
   // The functions called from here take care of initialization and alignment and randomization.
@@ -311,6 +631,18 @@ extern "C" void *malloc (size_t size_original)
   // The wrapper can handle backup allocation while initializing.
   if (!initialized && !initializing) initialize ();
 
+  // The same policy snapshot has to be used for both reserve and alignment.
+  policy_t policy_snapshot = current_policy ();
+  const policy_t *policy = &policy_snapshot;
+
+  // Small blocks can reuse the prefix of an earlier block.
+  // Paused threads do not, the prefix placement is randomized.
+  if (reuse_padding && !initializing && thread_padding && !thread_pause_depth && (size_original <= PADDING_BLOCK_MAX))
+  {
+    void *block_shifted = padding_malloc (size_original, policy);
+    if (block_shifted) return (block_shifted);
+  }
+
   // Allocate extra space, enough for header and random sized block.
   // Some parameters depend on whether this is backup allocation.
   size_t size_changed;
@@ -318,14 +650,14 @@ extern "C" void *malloc (size_t size_original)
   void *block_original;
   if (initializing)
   {
-    reserve = calculate_heap_reserve ();
+    reserve = calculate_heap_reserve (policy);
     size_changed = size_original + reserve;
     block_original = backup_malloc (size_changed);
     assert (!MASKED_POINTER (block_original, MALLOC_ALIGN_MASK_IN));
   }
   else
   {
-    reserve = calculate_heap_reserve ();
+    reserve = calculate_heap_reserve (policy);
     size_changed = size_original + reserve;
     block_original = (*original_malloc) (size_changed);
     assert (!MASKED_POINTER (block_original, MALLOC_ALIGN_MASK_IN));
@@ -335,14 +667,18 @@ extern "C" void *malloc (size_t size_original)
   if (!block_original) _exit (1);
   
   // Fill the header before shifted and aligned position and return that position.
-  void *block_shifted = MASKED_POINTER ((char *) block_original + reserve, align_mask_out);
+  void *block_shifted = MASKED_POINTER ((char *) block_original + reserve, policy->align_mask_out);
   assert (block_shifted >= block_original);
   assert ((char *) block_shifted + size_original <= (char *) block_original + size_changed);
   block_header_t *block_header = (block_header_t *) block_shifted - 1;
   assert (block_header >= block_original);
-  block_header->address = block_original;
+  block_header->address = (reuse_padding && !initializing) ? padding_create (block_original, block_header, size_original) : block_original;
   block_header->size = size_original;
 
+  thread_stats.allocations ++;
+  thread_stats.bytes_requested += size_original;
+  thread_stats.bytes_reserved += size_changed - size_original;
+
   return (block_shifted);
 }
 
@@ -354,17 +690,57 @@ extern "C" void free (void *block_shifted)
   // It is legal to free null pointers.
   if (!block_shifted) return;
 
+  thread_stats.frees ++;
+
   // We never free backup pointers.
   if (backup_pointer (block_shifted)) return;
 
   // Free the original block.
   block_header_t *block_header = (block_header_t *) block_shifted - 1;
   void *block_original = block_header->address;
+  if (PADDING_TAGGED (block_original))
+  {
+    padding_release (PADDING_TAGGED_CLEAR (block_original));
+    return;
+  }
   assert (block_header >= block_original);
   (*original_free) (block_original);
 }
 
 
+extern "C" size_t malloc_usable_size (void *block_shifted)
+{
+  if (!initialized && !initializing) initialize ();
+
+  // The usable size of null pointers is zero.
+  if (!block_shifted) return (0);
+
+  return (calculate_usable_size (block_shifted));
+}
+
+
+extern "C" int malloc_trim (size_t pad)
+{
+  if (!initialized && !initializing) initialize ();
+
+  // There is nothing to trim in the backup heap.
+  if (initializing) return (0);
+
+  return ((*original_malloc_trim) (pad));
+}
+
+
+extern "C" int malloc_info (int options, FILE *stream)
+{
+  if (!initialized && !initializing) initialize ();
+
+  // The statistics describe the original blocks, including the extra space allocated by the wrapper.
+  if (initializing) return (0);
+
+  return ((*original_malloc_info) (options, stream));
+}
+
+
 //---------------------------------------------------------------
 // Stack Allocator Wrapper
 
@@ -392,12 +768,14 @@ static void *thread_wrapper (void *arg)
   // There are no extra tests that the allocation actually takes place.
 
   // First allocate a random sized block on the thread stack.
-  size_t reserve = rand (random_bits) & align_mask_out;
+  policy_t policy_snapshot = current_policy ();
+  const policy_t *policy = &policy_snapshot;
+  size_t reserve = rand (policy->random_bits) & policy->align_mask_out;
   void *block_last = alloca (reserve);
   do_not_optimize = block_last;
 
   // Now keep allocating more until the current block is aligned.
-  while (MASKED_POINTER (block_last, align_mask_in))
+  while (MASKED_POINTER (block_last, policy->align_mask_in))
   {
     block_last = alloca (1);
     do_not_optimize = block_last;
@@ -420,3 +798,66 @@ extern "C" int pthread_create (pthread_t *thread, const pthread_attr_t *attr, vo
   // Call the thread wrapper instead of the original thread.
   return ((*original_pthread_create) (thread, attr, thread_wrapper, thread_information));
 }
+
+
+//---------------------------------------------------------------
+// Control Interface
+//
+// Entry points used by the inline functions in the header.
+// The entry points need no initialization because they
+// only touch the configuration.
+
+
+extern "C" int alloc_randomizer_set_bits (unsigned int align_bits, unsigned int random_bits)
+{
+  if (!valid_policy_bits (align_bits, random_bits)) return (-1);
+
+  set_global_bits (align_bits, random_bits);
+
+  return (0);
+}
+
+
+extern "C" int alloc_randomizer_push_policy (unsigned int align_bits, unsigned int random_bits)
+{
+  if (!valid_policy_bits (align_bits, random_bits)) return (-1);
+
+  // Running out of policy slots leaves the current policy in effect.
+  if (thread_policy_depth >= POLICY_DEPTH) return (-1);
+
+  make_policy (&thread_policy [thread_policy_depth], align_bits, random_bits);
+  thread_policy_depth ++;
+
+  return (0);
+}
+
+
+extern "C" void alloc_randomizer_pop_policy (void)
+{
+  if (thread_policy_depth) thread_policy_depth --;
+}
+
+
+extern "C" void alloc_randomizer_pause (void)
+{
+  thread_pause_depth ++;
+}
+
+
+extern "C" void alloc_randomizer_resume (void)
+{
+  if (thread_pause_depth) thread_pause_depth --;
+}
+
+
+extern "C" void alloc_randomizer_reseed (unsigned int seed)
+{
+  seed_value = seed;
+  seed_ready = true;
+}
+
+
+extern "C" void alloc_randomizer_get_stats (ar_stats_t *stats)
+{
+  *stats = thread_stats;
+}
@@ -0,0 +1,164 @@
+/*
+
+Copyright 2012 Petr Tuma
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ALLOC_RANDOMIZER_H
+#define ALLOC_RANDOMIZER_H
+
+// Control interface for applications that want to change
+// the randomizer behavior while running. The library entry
+// points are weak symbols, the inline functions below
+// do nothing when the library is not preloaded.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/// Allocation statistics of a single thread.
+typedef struct ar_stats_t
+{
+  /// Number of blocks allocated by the thread.
+  unsigned long long allocations;
+  /// Number of blocks freed by the thread.
+  unsigned long long frees;
+  /// Total size requested by the thread.
+  unsigned long long bytes_requested;
+  /// Total extra space allocated for header, alignment and randomization.
+  /// Blocks placed in reused padding count the space they take from the padding.
+  unsigned long long bytes_reserved;
+  /// Number of blocks placed in reused padding.
+  unsigned long long padding_allocations;
+  /// Total size placed in reused padding.
+  unsigned long long padding_bytes;
+} ar_stats_t;
+
+
+//---------------------------------------------------------------
+// Library Entry Points
+
+
+int alloc_randomizer_set_bits (unsigned int align_bits, unsigned int random_bits) __attribute__ ((weak));
+int alloc_randomizer_push_policy (unsigned int align_bits, unsigned int random_bits) __attribute__ ((weak));
+void alloc_randomizer_pop_policy (void) __attribute__ ((weak));
+void alloc_randomizer_pause (void) __attribute__ ((weak));
+void alloc_randomizer_resume (void) __attribute__ ((weak));
+void alloc_randomizer_reseed (unsigned int seed) __attribute__ ((weak));
+void alloc_randomizer_get_stats (ar_stats_t *stats) __attribute__ ((weak));
+
+
+//---------------------------------------------------------------
+// Application Interface
+
+
+/** Tell whether the library is loaded.
+ */
+static inline int ar_present (void)
+{
+  return (alloc_randomizer_set_bits != 0);
+}
+
+
+/** Set alignment and randomization in global configuration.
+ *
+ * Both bit counts must be between 0 and 31.
+ * Threads with their own policy are not affected.
+ * The change is atomic, allocations in other threads see either the old or the new configuration.
+ * Returns zero on success, and also when the library is not loaded, minus one when a bit count is out of range.
+ */
+static inline int ar_set_bits (unsigned int align_bits, unsigned int random_bits)
+{
+  if (alloc_randomizer_set_bits) return (alloc_randomizer_set_bits (align_bits, random_bits));
+  return (0);
+}
+
+
+/** Use given alignment and randomization in the calling thread until the matching pop.
+ *
+ * Both bit counts must be between 0 and 31.
+ * Policies nest, the innermost policy applies.
+ * At most 16 policies can be nested, a push beyond that leaves the current policy in effect.
+ * Returns zero on success, and also when the library is not loaded,
+ * minus one when a bit count is out of range or when too deeply nested.
+ * A push that failed must not be matched by a pop.
+ */
+static inline int ar_push_policy (unsigned int align_bits, unsigned int random_bits)
+{
+  if (alloc_randomizer_push_policy) return (alloc_randomizer_push_policy (align_bits, random_bits));
+  return (0);
+}
+
+
+/** Return the calling thread to the policy in effect before the matching push.
+ */
+static inline void ar_pop_policy (void)
+{
+  if (alloc_randomizer_pop_policy) alloc_randomizer_pop_policy ();
+}
+
+
+/** Stop alignment and randomization in the calling thread until the matching resume.
+ *
+ * Blocks allocated while paused can still be freed or resized at any time.
+ * Blocks allocated while paused are never placed in reused padding.
+ */
+static inline void ar_pause (void)
+{
+  if (alloc_randomizer_pause) alloc_randomizer_pause ();
+}
+
+
+/** Continue alignment and randomization in the calling thread.
+ */
+static inline void ar_resume (void)
+{
+  if (alloc_randomizer_resume) alloc_randomizer_resume ();
+}
+
+
+/** Restart the random generator of the calling thread with given seed.
+ */
+static inline void ar_reseed (unsigned int seed)
+{
+  if (alloc_randomizer_reseed) alloc_randomizer_reseed (seed);
+}
+
+
+/** Retrieve the allocation statistics of the calling thread.
+ *
+ * The statistics are all zero when the library is not loaded.
+ */
+static inline void ar_get_stats (ar_stats_t *stats)
+{
+  if (alloc_randomizer_get_stats) alloc_randomizer_get_stats (stats);
+  else
+  {
+    stats->allocations = 0;
+    stats->frees = 0;
+    stats->bytes_requested = 0;
+    stats->bytes_reserved = 0;
+    stats->padding_allocations = 0;
+    stats->padding_bytes = 0;
+  }
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
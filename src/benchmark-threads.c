@@ -0,0 +1,276 @@
+/*
+
+Copyright 2012 Petr Tuma
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// Multiple thread allocation benchmark. Unlike the test code,
+// the benchmark does not include the library code, it is meant
+// to be run both with and without the library preloaded.
+
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+
+//---------------------------------------------------------------
+// Benchmark Settings
+
+
+/// Assumed cache line size, used to keep per thread data apart.
+#define CACHE_LINE_SIZE 64
+
+/// Number of blocks each thread keeps allocated in the churn mode.
+#define CHURN_SLOTS 1024
+
+/// Capacity of the queue between neighbor threads in the transfer mode.
+#define QUEUE_SLOTS 1024
+
+/// Default maximum block size, sizes are uniform between one and this.
+#define BLOCK_SIZE_MAX 512
+
+/// How many operations between checks of the stop flag.
+#define OPERATIONS_PER_CHECK 1024
+
+
+//---------------------------------------------------------------
+// Helpers
+
+
+static size_t block_size_max = BLOCK_SIZE_MAX;
+
+
+static inline size_t random_size (unsigned int *seed)
+{
+  return (1 + rand_r (seed) % block_size_max);
+}
+
+
+static inline void touch_block (void *block, size_t size)
+{
+  // Writing the block makes the allocation visible to the caches.
+  memset (block, 0, size);
+}
+
+
+//---------------------------------------------------------------
+// Thread Data
+
+
+/// Single producer single consumer queue.
+/// The producer and consumer positions are kept on separate cache lines.
+struct queue_t
+{
+  void *slots [QUEUE_SLOTS];
+  volatile size_t head __attribute__ ((aligned (CACHE_LINE_SIZE)));
+  volatile size_t tail __attribute__ ((aligned (CACHE_LINE_SIZE)));
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+
+/// Per thread benchmark state.
+struct worker_t
+{
+  pthread_t thread;
+  unsigned int seed;
+  /// Queue this thread consumes from.
+  queue_t *queue_in;
+  /// Queue this thread produces to.
+  queue_t *queue_out;
+  /// Number of allocations performed.
+  unsigned long long operations;
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+
+static volatile bool stop = false;
+
+
+static inline bool queue_push (queue_t *queue, void *block)
+{
+  size_t head = queue->head;
+  size_t tail = __atomic_load_n (&queue->tail, __ATOMIC_ACQUIRE);
+  if (head - tail >= QUEUE_SLOTS) return (false);
+  queue->slots [head % QUEUE_SLOTS] = block;
+  __atomic_store_n (&queue->head, head + 1, __ATOMIC_RELEASE);
+  return (true);
+}
+
+
+static inline void *queue_pop (queue_t *queue)
+{
+  size_t tail = queue->tail;
+  size_t head = __atomic_load_n (&queue->head, __ATOMIC_ACQUIRE);
+  if (head == tail) return (NULL);
+  void *block = queue->slots [tail % QUEUE_SLOTS];
+  __atomic_store_n (&queue->tail, tail + 1, __ATOMIC_RELEASE);
+  return (block);
+}
+
+
+//---------------------------------------------------------------
+// Workloads
+
+
+/** Allocate and free blocks within a single thread.
+ *
+ * Each thread keeps a fixed number of blocks and replaces a random one in each operation.
+ */
+static void *churn_thread (void *arg)
+{
+  worker_t *worker = (worker_t *) arg;
+
+  void *slots [CHURN_SLOTS];
+  for (int slot = 0 ; slot < CHURN_SLOTS ; slot ++)
+  {
+    size_t size = random_size (&worker->seed);
+    slots [slot] = malloc (size);
+    touch_block (slots [slot], size);
+  }
+
+  unsigned long long operations = 0;
+  while (!stop)
+  {
+    for (int i = 0 ; i < OPERATIONS_PER_CHECK ; i ++)
+    {
+      int slot = rand_r (&worker->seed) % CHURN_SLOTS;
+      free (slots [slot]);
+      size_t size = random_size (&worker->seed);
+      slots [slot] = malloc (size);
+      touch_block (slots [slot], size);
+    }
+    operations += OPERATIONS_PER_CHECK;
+  }
+
+  for (int slot = 0 ; slot < CHURN_SLOTS ; slot ++) free (slots [slot]);
+
+  worker->operations = operations;
+  return (NULL);
+}
+
+
+/** Allocate blocks in one thread and free them in another.
+ *
+ * Threads form a ring, each thread passes its blocks to the next one.
+ * When the next thread is too slow, the blocks are freed locally.
+ */
+static void *transfer_thread (void *arg)
+{
+  worker_t *worker = (worker_t *) arg;
+
+  unsigned long long operations = 0;
+  while (!stop)
+  {
+    for (int i = 0 ; i < OPERATIONS_PER_CHECK ; i ++)
+    {
+      size_t size = random_size (&worker->seed);
+      void *block = malloc (size);
+      touch_block (block, size);
+      if (!queue_push (worker->queue_out, block)) free (block);
+      free (queue_pop (worker->queue_in));
+    }
+    operations += OPERATIONS_PER_CHECK;
+  }
+
+  // The remaining blocks are freed by the main thread.
+
+  worker->operations = operations;
+  return (NULL);
+}
+
+
+//---------------------------------------------------------------
+// Main
+
+
+static void usage (const char *name)
+{
+  fprintf (stderr, "Usage: %s churn|transfer <threads> <seconds> [<block size max>]\n", name);
+  exit (1);
+}
+
+
+int main (int argc, char *argv [])
+{
+  if ((argc != 4) && (argc != 5)) usage (argv [0]);
+
+  void *(*workload) (void *);
+  if (!strcmp (argv [1], "churn")) workload = churn_thread;
+  else if (!strcmp (argv [1], "transfer")) workload = transfer_thread;
+  else usage (argv [0]);
+
+  int threads = atoi (argv [2]);
+  int seconds = atoi (argv [3]);
+  int size = (argc == 5) ? atoi (argv [4]) : BLOCK_SIZE_MAX;
+  if ((threads < 1) || (seconds < 1) || (size < 1)) usage (argv [0]);
+  block_size_max = size;
+
+  worker_t *workers = new worker_t [threads];
+  queue_t *queues = new queue_t [threads];
+  for (int thread = 0 ; thread < threads ; thread ++)
+  {
+    queues [thread].head = 0;
+    queues [thread].tail = 0;
+    workers [thread].seed = thread;
+    workers [thread].queue_in = &queues [thread];
+    workers [thread].queue_out = &queues [(thread + 1) % threads];
+    workers [thread].operations = 0;
+  }
+
+  struct timespec time_start;
+  struct timespec time_end;
+  clock_gettime (CLOCK_MONOTONIC, &time_start);
+
+  for (int thread = 0 ; thread < threads ; thread ++)
+  {
+    pthread_create (&workers [thread].thread, NULL, workload, &workers [thread]);
+  }
+  sleep (seconds);
+  stop = true;
+
+  unsigned long long operations = 0;
+  for (int thread = 0 ; thread < threads ; thread ++)
+  {
+    pthread_join (workers [thread].thread, NULL);
+    operations += workers [thread].operations;
+  }
+
+  clock_gettime (CLOCK_MONOTONIC, &time_end);
+  double duration = (time_end.tv_sec - time_start.tv_sec) + (time_end.tv_nsec - time_start.tv_nsec) / 1e9;
+
+  for (int thread = 0 ; thread < threads ; thread ++)
+  {
+    void *block;
+    while ((block = queue_pop (&queues [thread]))) free (block);
+  }
+  delete [] (queues);
+  delete [] (workers);
+
+  printf ("Mode: %s\n", argv [1]);
+  printf ("Threads: %d\n", threads);
+  printf ("Block size: 1 - %zu\n", block_size_max);
+  printf ("Operations performed: %llu (%.2f ops/sec)\n", operations, operations / duration);
+  printf ("Operations per thread: %.2f ops/sec\n", operations / duration / threads);
+
+  // Memory overhead of the library shows in the resident size.
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  printf ("Maximum resident size: %ld kB\n", usage.ru_maxrss);
+
+  return (0);
+}
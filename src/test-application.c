@@ -24,6 +24,8 @@ limitations under the License.
 #include "alloc-randomizer.c"
 
 
+#include <set>
+
 #include <boost/dynamic_bitset.hpp>
 
 
@@ -50,6 +52,14 @@ limitations under the License.
 #define UNSIGNED_DIFFERENCE(a,b) (((a) > (b)) ? ((a) - (b)) : 0)
 
 
+/// Reserve calculated with the policy of the calling thread.
+static size_t current_heap_reserve (void)
+{
+  policy_t policy = current_policy ();
+  return (calculate_heap_reserve (&policy));
+}
+
+
 //---------------------------------------------------------------
 // Test Initialization
 
@@ -84,7 +94,7 @@ BOOST_AUTO_TEST_CASE (calculate_heap_reserve_align_test)
   {
     set_align_bits (ab);
     BOOST_CHECK_EQUAL (
-      calculate_heap_reserve (),
+      current_heap_reserve (),
       MAX (
         ALIGNED_SIZE (sizeof (block_header_t), ab),
         UNSIGNED_DIFFERENCE (BITS_TO_SIZE (ab), MALLOC_ALIGN_SIZE)));
@@ -99,7 +109,7 @@ BOOST_AUTO_TEST_CASE (calculate_heap_reserve_random_test)
     set_align_bits (xb);
     set_random_bits (xb);
     BOOST_CHECK_EQUAL (
-      calculate_heap_reserve (),
+      current_heap_reserve (),
       MAX (
         ALIGNED_SIZE (sizeof (block_header_t), xb),
         BITS_TO_SIZE (xb) - 1));
@@ -115,7 +125,7 @@ BOOST_AUTO_TEST_CASE (calculate_heap_reserve_random_test)
     for (int i = 0 ; i < RANDOM_TEST_CYCLES ; i ++)
     {
       BOOST_CHECK_LT (
-        calculate_heap_reserve (),
+        current_heap_reserve (),
         BITS_TO_SIZE (rb) + sizeof (block_header_t));
     }
   }
@@ -127,11 +137,11 @@ BOOST_AUTO_TEST_CASE (calculate_heap_reserve_random_test)
   for (int rb = 1 ; rb <= RANDOM_MAX ; rb ++)
   {
     set_random_bits (rb);
-    size_t first_offset = calculate_heap_reserve ();
+    size_t first_offset = current_heap_reserve ();
     bool different = false;
     for (int i = 0 ; i < RANDOM_TEST_CYCLES ; i ++)
     {
-      if (calculate_heap_reserve () != first_offset)
+      if (current_heap_reserve () != first_offset)
       {
         different = true;
         break;
@@ -200,6 +210,81 @@ BOOST_AUTO_TEST_CASE (malloc_free_random_test)
 BOOST_AUTO_TEST_SUITE_END ()
 
 
+//---------------------------------------------------------------
+// Usable Size Tests
+
+
+BOOST_AUTO_TEST_SUITE (usable_size_test)
+
+BOOST_AUTO_TEST_CASE (usable_size_range_test)
+{
+  // The usable size must cover the requested size.
+  // The usable size must not reach beyond the original block.
+  for (int ab = 0 ; ab <= ALIGN_MAX ; ab ++)
+  {
+    set_align_bits (ab);
+    set_random_bits (MAX (ab, RANDOM_MAX / 2));
+    for (int i = 0 ; i < RANDOM_TEST_CYCLES ; i ++)
+    {
+      size_t size = rand (ab + 1);
+      char *block = (char *) malloc (size);
+      size_t usable = malloc_usable_size (block);
+      BOOST_CHECK_GE (usable, size);
+      block_header_t *header = (block_header_t *) block - 1;
+      BOOST_CHECK_EQUAL (
+        block + usable,
+        (char *) header->address + (*original_malloc_usable_size) (header->address));
+      memset (block, 0, usable);
+      free (block);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE (usable_size_realloc_test)
+{
+  set_align_bits (ALIGN_MAX / 2);
+  set_random_bits (RANDOM_MAX);
+
+  // Data in the entire usable size must survive reallocation.
+  for (int i = 0 ; i < RANDOM_TEST_CYCLES ; i ++)
+  {
+    char *block = (char *) malloc (rand (8));
+    size_t usable = malloc_usable_size (block);
+    memset (block, 0x5A, usable);
+    block = (char *) realloc (block, usable + 1);
+    for (size_t pos = 0 ; pos < usable ; pos ++)
+    {
+      if (block [pos] != 0x5A)
+      {
+        BOOST_ERROR ("Data lost in reallocation.");
+        break;
+      }
+    }
+    free (block);
+  }
+}
+
+BOOST_AUTO_TEST_CASE (usable_size_null_test)
+{
+  BOOST_CHECK_EQUAL (malloc_usable_size (NULL), 0u);
+}
+
+BOOST_AUTO_TEST_CASE (reallocarray_overflow_test)
+{
+  // The count is volatile to keep the compiler from rejecting the overflow statically.
+  volatile size_t count = SIZE_MAX / 2;
+  errno = 0;
+  BOOST_CHECK (!reallocarray (NULL, count, 3));
+  BOOST_CHECK_EQUAL (errno, ENOMEM);
+
+  char *block = (char *) reallocarray (NULL, 16, 4);
+  BOOST_CHECK_GE (malloc_usable_size (block), 64u);
+  free (block);
+}
+
+BOOST_AUTO_TEST_SUITE_END ()
+
+
 //---------------------------------------------------------------
 // New And Delete Tests
 
@@ -256,6 +341,342 @@ BOOST_AUTO_TEST_CASE (new_delete_random_test)
 BOOST_AUTO_TEST_SUITE_END ()
 
 
+//---------------------------------------------------------------
+// Control Interface Tests
+
+
+BOOST_AUTO_TEST_SUITE (control_test)
+
+BOOST_AUTO_TEST_CASE (control_policy_test)
+{
+  ar_set_bits (0, 0);
+
+  // The innermost policy should apply.
+  // Popping should return to the outer policy.
+  BOOST_CHECK_EQUAL (ar_push_policy (ALIGN_MAX / 2, ALIGN_MAX / 2), 0);
+  BOOST_CHECK_EQUAL (ar_push_policy (ALIGN_MAX, ALIGN_MAX), 0);
+  for (int i = 0 ; i < RANDOM_TEST_CYCLES ; i ++)
+  {
+    void *block = malloc (rand (8));
+    BOOST_CHECK (!MASKED_POINTER (block, BITS_TO_MASK_IN (ALIGN_MAX)));
+    free (block);
+  }
+  ar_pop_policy ();
+  BOOST_CHECK_EQUAL (current_policy ().align_bits, ALIGN_MAX / 2);
+  ar_pop_policy ();
+  BOOST_CHECK_EQUAL (current_policy ().align_bits, 0u);
+
+  // Unbalanced pops should be harmless.
+  ar_pop_policy ();
+  BOOST_CHECK_EQUAL (current_policy ().align_bits, 0u);
+}
+
+BOOST_AUTO_TEST_CASE (control_policy_depth_test)
+{
+  ar_set_bits (0, 0);
+
+  // Pushing too deep should fail and keep the innermost policy.
+  for (int depth = 0 ; depth < POLICY_DEPTH ; depth ++)
+  {
+    BOOST_CHECK_EQUAL (ar_push_policy (depth, depth), 0);
+  }
+  BOOST_CHECK_EQUAL (ar_push_policy (ALIGN_MAX, ALIGN_MAX), -1);
+  BOOST_CHECK_EQUAL (current_policy ().align_bits, POLICY_DEPTH - 1u);
+
+  for (int depth = 0 ; depth < POLICY_DEPTH ; depth ++) ar_pop_policy ();
+  BOOST_CHECK_EQUAL (current_policy ().align_bits, 0u);
+}
+
+BOOST_AUTO_TEST_CASE (control_range_test)
+{
+  ar_set_bits (0, 0);
+
+  // Bit counts out of range should be rejected and leave the policy unchanged.
+  BOOST_CHECK_EQUAL (ar_set_bits (POLICY_BITS_MAX + 1, 0), -1);
+  BOOST_CHECK_EQUAL (ar_set_bits (0, POLICY_BITS_MAX + 1), -1);
+  BOOST_CHECK_EQUAL (ar_set_bits (64, 64), -1);
+  BOOST_CHECK_EQUAL (current_policy ().align_bits, 0u);
+  BOOST_CHECK_EQUAL (current_policy ().random_bits, 0u);
+  BOOST_CHECK_EQUAL (ar_push_policy (POLICY_BITS_MAX + 1, 0), -1);
+  BOOST_CHECK_EQUAL (ar_push_policy (0, POLICY_BITS_MAX + 1), -1);
+  BOOST_CHECK_EQUAL (thread_policy_depth, 0u);
+
+  // The limits themselves are valid.
+  BOOST_CHECK_EQUAL (ar_set_bits (POLICY_BITS_MAX, POLICY_BITS_MAX), 0);
+  BOOST_CHECK_EQUAL (ar_push_policy (POLICY_BITS_MAX, POLICY_BITS_MAX), 0);
+  ar_pop_policy ();
+  ar_set_bits (0, 0);
+}
+
+/// Set while the policy changing thread should keep running.
+static volatile bool policy_change_running;
+
+void *policy_change_thread (void *)
+{
+  while (policy_change_running)
+  {
+    ar_set_bits (MALLOC_ALIGN_BITS, 0);
+    ar_set_bits (12, 12);
+  }
+
+  return (NULL);
+}
+
+BOOST_AUTO_TEST_CASE (control_policy_change_test)
+{
+  // Changing the global policy in parallel with allocations must not break blocks.
+  // Every block should be aligned to either policy and its header should be within the original block.
+  policy_change_running = true;
+  pthread_t thread;
+  pthread_create (&thread, NULL, policy_change_thread, NULL);
+  for (int i = 0 ; i < RANDOM_TEST_CYCLES * 16 ; i ++)
+  {
+    void *block = malloc (rand (8));
+    block_header_t *header = (block_header_t *) block - 1;
+    BOOST_CHECK (!MASKED_POINTER (block, MALLOC_ALIGN_MASK_IN));
+    BOOST_CHECK ((void *) header >= header->address);
+    free (block);
+  }
+  policy_change_running = false;
+  pthread_join (thread, NULL);
+  ar_set_bits (0, 0);
+}
+
+BOOST_AUTO_TEST_CASE (control_pause_test)
+{
+  ar_set_bits (ALIGN_MAX / 2, RANDOM_MAX);
+
+  // Pausing should remove any extra space except the header.
+  ar_pause ();
+  for (int i = 0 ; i < RANDOM_TEST_CYCLES ; i ++)
+  {
+    BOOST_CHECK_EQUAL (current_heap_reserve (), sizeof (block_header_t));
+  }
+  ar_resume ();
+  BOOST_CHECK_EQUAL (current_policy ().align_bits, ALIGN_MAX / 2);
+}
+
+BOOST_AUTO_TEST_CASE (control_reseed_test)
+{
+  ar_set_bits (0, RANDOM_MAX);
+
+  // The same seed should produce the same sequence of reserves.
+  size_t reserves [RANDOM_TEST_CYCLES];
+  ar_reseed (42);
+  for (int i = 0 ; i < RANDOM_TEST_CYCLES ; i ++) reserves [i] = current_heap_reserve ();
+  ar_reseed (42);
+  for (int i = 0 ; i < RANDOM_TEST_CYCLES ; i ++) BOOST_CHECK_EQUAL (current_heap_reserve (), reserves [i]);
+}
+
+BOOST_AUTO_TEST_CASE (control_stats_test)
+{
+  ar_set_bits (ALIGN_MAX / 2, RANDOM_MAX);
+
+  // Every allocation and free should be counted.
+  ar_stats_t before;
+  ar_stats_t after;
+  ar_get_stats (&before);
+  for (int i = 0 ; i < RANDOM_TEST_CYCLES ; i ++) free (malloc (100));
+  ar_get_stats (&after);
+  BOOST_CHECK_EQUAL (after.allocations - before.allocations, (unsigned long long) RANDOM_TEST_CYCLES);
+  BOOST_CHECK_EQUAL (after.frees - before.frees, (unsigned long long) RANDOM_TEST_CYCLES);
+  BOOST_CHECK_EQUAL (after.bytes_requested - before.bytes_requested, (unsigned long long) RANDOM_TEST_CYCLES * 100);
+  BOOST_CHECK_GE (after.bytes_reserved - before.bytes_reserved, (unsigned long long) RANDOM_TEST_CYCLES * sizeof (block_header_t));
+
+  // With random bits masked by alignment, every block gets the same reserve.
+  ar_set_bits (ALIGN_MAX / 2, ALIGN_MAX / 2);
+  ar_get_stats (&before);
+  free (malloc (100));
+  ar_get_stats (&after);
+  BOOST_CHECK_EQUAL (after.bytes_reserved - before.bytes_reserved, (unsigned long long) current_heap_reserve ());
+}
+
+BOOST_AUTO_TEST_SUITE_END ()
+
+
+//---------------------------------------------------------------
+// Padding Reuse Tests
+
+
+#define PADDING_TEST_BLOCKS 4096
+
+BOOST_AUTO_TEST_SUITE (padding_test)
+
+BOOST_AUTO_TEST_CASE (padding_reuse_test)
+{
+  set_align_bits (ALIGN_MAX / 4);
+  set_random_bits (12);
+  set_reuse_padding (true);
+
+  ar_stats_t before;
+  ar_get_stats (&before);
+
+  // Blocks must be aligned and must not overlap.
+  // Every block is filled and checked later to detect overlaps.
+  static unsigned char *blocks [PADDING_TEST_BLOCKS];
+  static size_t sizes [PADDING_TEST_BLOCKS];
+  for (int block = 0 ; block < PADDING_TEST_BLOCKS ; block ++)
+  {
+    sizes [block] = 1 + rand (8) % PADDING_BLOCK_MAX;
+    blocks [block] = (unsigned char *) malloc (sizes [block]);
+    BOOST_CHECK (!MASKED_POINTER (blocks [block], BITS_TO_MASK_IN (ALIGN_MAX / 4)));
+    BOOST_CHECK_GE (malloc_usable_size (blocks [block]), sizes [block]);
+    memset (blocks [block], block & 0xFF, sizes [block]);
+  }
+  for (int block = 0 ; block < PADDING_TEST_BLOCKS ; block ++)
+  {
+    for (size_t pos = 0 ; pos < sizes [block] ; pos ++)
+    {
+      if (blocks [block] [pos] != (block & 0xFF))
+      {
+        BOOST_ERROR ("Block overwritten.");
+        break;
+      }
+    }
+  }
+
+  ar_stats_t after;
+  ar_get_stats (&after);
+  BOOST_CHECK_GT (after.padding_allocations, before.padding_allocations);
+
+  // Host blocks are freed first in every other block.
+  // Blocks placed in their prefix must stay usable.
+  for (int block = 0 ; block < PADDING_TEST_BLOCKS ; block += 2) free (blocks [block]);
+  for (int block = 1 ; block < PADDING_TEST_BLOCKS ; block += 2)
+  {
+    memset (blocks [block], 0, sizes [block]);
+    free (blocks [block]);
+  }
+
+  padding_detach ();
+  set_reuse_padding (false);
+}
+
+BOOST_AUTO_TEST_CASE (padding_empty_test)
+{
+  set_align_bits (MALLOC_ALIGN_BITS);
+  set_random_bits (12);
+  set_reuse_padding (true);
+
+  // Empty blocks placed in a prefix must not extend into the host block.
+  // Writing the whole usable size and freeing everything must not break anything.
+  static void *blocks [PADDING_TEST_BLOCKS];
+  for (int block = 0 ; block < PADDING_TEST_BLOCKS ; block ++)
+  {
+    blocks [block] = malloc (0);
+    block_header_t *header = (block_header_t *) blocks [block] - 1;
+    if (PADDING_TAGGED (header->address))
+    {
+      padding_t *padding = PADDING_TAGGED_CLEAR (header->address);
+      if ((char *) header < padding->end)
+      {
+        BOOST_CHECK_EQUAL (malloc_usable_size (blocks [block]), 0u);
+        BOOST_CHECK ((char *) blocks [block] < padding->end);
+      }
+    }
+    memset (blocks [block], 0xFF, malloc_usable_size (blocks [block]));
+  }
+  for (int block = 0 ; block < PADDING_TEST_BLOCKS ; block ++) free (blocks [block]);
+
+  padding_detach ();
+  set_reuse_padding (false);
+}
+
+BOOST_AUTO_TEST_CASE (padding_pause_test)
+{
+  set_align_bits (MALLOC_ALIGN_BITS);
+  set_random_bits (12);
+  set_reuse_padding (true);
+
+  // Make sure the thread has a prefix to place blocks in.
+  void *host = NULL;
+  while (!thread_padding)
+  {
+    free (host);
+    host = malloc (64);
+  }
+
+  // Paused threads should not place blocks in the prefix.
+  ar_pause ();
+  ar_stats_t before;
+  ar_stats_t after;
+  ar_get_stats (&before);
+  for (int i = 0 ; i < RANDOM_TEST_CYCLES ; i ++) free (malloc (1));
+  ar_get_stats (&after);
+  BOOST_CHECK_EQUAL (after.padding_allocations, before.padding_allocations);
+  ar_resume ();
+
+  free (host);
+  padding_detach ();
+  set_reuse_padding (false);
+}
+
+BOOST_AUTO_TEST_CASE (padding_outlive_test)
+{
+  set_align_bits (MALLOC_ALIGN_BITS);
+  set_random_bits (12);
+  set_reuse_padding (true);
+
+  // Small blocks that outlive large blocks must not keep the large blocks allocated.
+  // Every original block still referenced must be small.
+  static void *blocks [PADDING_TEST_BLOCKS / 16];
+  for (int block = 0 ; block < PADDING_TEST_BLOCKS / 16 ; block ++)
+  {
+    size_t size = 65536 << (block % 5);
+    void *large = malloc (size);
+    memset (large, 0, size);
+    blocks [block] = malloc (16);
+    free (large);
+  }
+  for (int block = 0 ; block < PADDING_TEST_BLOCKS / 16 ; block ++)
+  {
+    void *original = ((block_header_t *) blocks [block] - 1)->address;
+    if (PADDING_TAGGED (original)) original = PADDING_TAGGED_CLEAR (original);
+    BOOST_CHECK_LE ((*original_malloc_usable_size) (original), PADDING_HOST_MAX + CACHE_LINE_SIZE);
+  }
+  for (int block = 0 ; block < PADDING_TEST_BLOCKS / 16 ; block ++) free (blocks [block]);
+
+  padding_detach ();
+  set_reuse_padding (false);
+}
+
+BOOST_AUTO_TEST_CASE (padding_overhead_test)
+{
+  set_align_bits (ALIGN_MAX / 4);
+  set_random_bits (12);
+
+  // Reuse should reduce the memory taken from the original allocator for the same workload.
+  // The footprint is the usable size of all distinct original blocks.
+  size_t footprint [2];
+  for (int reuse = 0 ; reuse < 2 ; reuse ++)
+  {
+    set_reuse_padding (reuse);
+    static void *blocks [PADDING_TEST_BLOCKS];
+    std::set <void *> originals;
+    for (int block = 0 ; block < PADDING_TEST_BLOCKS ; block ++)
+    {
+      blocks [block] = malloc (32);
+      void *original = ((block_header_t *) blocks [block] - 1)->address;
+      if (PADDING_TAGGED (original)) original = PADDING_TAGGED_CLEAR (original);
+      originals.insert (original);
+    }
+    footprint [reuse] = 0;
+    for (std::set <void *>::iterator original = originals.begin () ; original != originals.end () ; original ++)
+    {
+      footprint [reuse] += (*original_malloc_usable_size) (*original);
+    }
+    for (int block = 0 ; block < PADDING_TEST_BLOCKS ; block ++) free (blocks [block]);
+    padding_detach ();
+  }
+  BOOST_TEST_MESSAGE ("Footprint without reuse " << footprint [0] << " with reuse " << footprint [1]);
+  BOOST_CHECK_LT (footprint [1], footprint [0]);
+
+  set_reuse_padding (false);
+}
+
+BOOST_AUTO_TEST_SUITE_END ()
+
+
 //---------------------------------------------------------------
 // Multiple Thread Tests
 
@@ -307,4 +728,83 @@ BOOST_AUTO_TEST_CASE (thread_align_test)
   pthread_join (thread_two, NULL);
 }
 
+/// Blocks allocated by one thread and freed by another.
+static void *transfer_blocks [BLOCKS_PER_CYCLE];
+
+void *transfer_thread (void *)
+{
+  // Blocks allocated elsewhere must be freed correctly.
+  for (int block = 0 ; block < BLOCKS_PER_CYCLE ; block ++)
+  {
+    free (transfer_blocks [block]);
+  }
+
+  return (NULL);
+}
+
+BOOST_AUTO_TEST_CASE (thread_transfer_test)
+{
+  set_align_bits (ALIGN_MAX / 2);
+  set_random_bits (RANDOM_MAX);
+
+  ar_stats_t before;
+  ar_get_stats (&before);
+
+  for (int cycle = 0 ; cycle < CYCLES_PER_THREAD / 10 ; cycle ++)
+  {
+    for (int block = 0 ; block < BLOCKS_PER_CYCLE ; block ++)
+    {
+      transfer_blocks [block] = malloc (rand (8));
+    }
+    pthread_t thread;
+    pthread_create (&thread, NULL, transfer_thread, NULL);
+    pthread_join (thread, NULL);
+  }
+
+  // The frees should count in the thread that performed them.
+  ar_stats_t after;
+  ar_get_stats (&after);
+  BOOST_CHECK_GE (after.allocations - before.allocations, (unsigned long long) (CYCLES_PER_THREAD / 10) * BLOCKS_PER_CYCLE);
+  BOOST_CHECK_LT (after.frees - before.frees, (unsigned long long) BLOCKS_PER_CYCLE);
+}
+
+/// Host block and prefix left behind by an exiting thread.
+static void *exit_block;
+static padding_t *exit_padding;
+
+void *exit_thread (void *)
+{
+  // Allocate until some block gets a prefix, keep that block and free the rest.
+  while (!thread_padding)
+  {
+    void *block = malloc (64);
+    if (!thread_padding) free (block);
+    else exit_block = block;
+  }
+  exit_padding = thread_padding;
+
+  // The thread exit can allocate, for example when loading the unwinder.
+  // The prefix is filled up so that such blocks do not keep it referenced.
+  exit_padding->next = exit_padding->end;
+
+  pthread_exit (NULL);
+}
+
+BOOST_AUTO_TEST_CASE (thread_exit_test)
+{
+  set_align_bits (MALLOC_ALIGN_BITS);
+  set_random_bits (12);
+  set_reuse_padding (true);
+
+  // Threads that do not return from the thread routine must release their prefix too.
+  // Only the reference from the host block should remain.
+  pthread_t thread;
+  pthread_create (&thread, NULL, exit_thread, NULL);
+  pthread_join (thread, NULL);
+  BOOST_CHECK_EQUAL (exit_padding->references, 1u);
+  free (exit_block);
+
+  set_reuse_padding (false);
+}
+
 BOOST_AUTO_TEST_SUITE_END ()
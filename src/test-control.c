@@ -0,0 +1,106 @@
+/*
+
+Copyright 2012 Petr Tuma
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// Control interface test. Unlike the main test code, this
+// only includes the header, it is meant to be run both with
+// and without the library preloaded, with the argument
+// telling which of the two is expected.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc-randomizer.h"
+
+
+static int failures = 0;
+
+#define CHECK(x) { if (!(x)) { fprintf (stderr, "%s:%d: check %s failed\n", __FILE__, __LINE__, #x); failures ++; } }
+
+
+/** Without the library, all calls should do nothing.
+ */
+static void test_absent (void)
+{
+  CHECK (!ar_present ());
+  CHECK (ar_set_bits (12, 12) == 0);
+  CHECK (ar_push_policy (12, 12) == 0);
+  ar_pop_policy ();
+  ar_pause ();
+  ar_resume ();
+  ar_reseed (42);
+
+  free (malloc (16));
+
+  ar_stats_t stats;
+  memset (&stats, 0xFF, sizeof (stats));
+  ar_get_stats (&stats);
+  CHECK (stats.allocations == 0);
+  CHECK (stats.frees == 0);
+  CHECK (stats.bytes_requested == 0);
+  CHECK (stats.bytes_reserved == 0);
+  CHECK (stats.padding_allocations == 0);
+  CHECK (stats.padding_bytes == 0);
+}
+
+
+/** With the library, the calls should reach it.
+ */
+static void test_present (void)
+{
+  CHECK (ar_present ());
+  CHECK (ar_set_bits (64, 0) == -1);
+  CHECK (ar_push_policy (0, 64) == -1);
+
+  ar_stats_t before;
+  ar_stats_t after;
+  ar_get_stats (&before);
+
+  // Every block allocated under the pushed policy should be aligned.
+  CHECK (ar_push_policy (12, 12) == 0);
+  for (int i = 0 ; i < 16 ; i ++)
+  {
+    void *block = malloc (16);
+    CHECK (!(((uintptr_t) block) & 0xFFF));
+    free (block);
+  }
+  ar_pop_policy ();
+
+  ar_get_stats (&after);
+  CHECK (after.allocations - before.allocations >= 16);
+  CHECK (after.frees - before.frees >= 16);
+}
+
+
+int main (int argc, char *argv [])
+{
+  if ((argc != 2) || (strcmp (argv [1], "absent") && strcmp (argv [1], "present")))
+  {
+    fprintf (stderr, "Usage: %s absent|present\n", argv [0]);
+    return (1);
+  }
+
+  if (!strcmp (argv [1], "absent")) test_absent ();
+  else test_present ();
+
+  if (failures) fprintf (stderr, "%d failures detected\n", failures);
+  else printf ("No errors detected\n");
+
+  return (failures ? 1 : 0);
+}